@@ -1,32 +1,41 @@
 #include <fstream>
 #include <iostream>
+#include <string>
 
 int main(int argc, char** argv) {
-    if (argc != 3) {
-        std::cout << "Usage: " << argv[0] << "first_output second_output" << std::endl;
+    if (argc != 3 && argc != 4) {
+        std::cout << "Usage: " << argv[0] << " first_output second_output [tolerance]" << std::endl;
         return 1;
     }
     std::ifstream fst_file(argv[1]);
     std::ifstream snd_file(argv[2]);
+    double tolerance = argc == 4 ? std::stod(argv[3]) : 1e-6;
     double fst;
     double snd;
     double res = 0;
-    int counter;
-    while (fst_file.good() && snd_file.good()) {
-        fst_file >> fst;
-        snd_file >> snd;
+    int counter = 0;
+    while (fst_file >> fst) {
+        if (!(snd_file >> snd)) {
+            std::cout << "Reached end only in one file" << std::endl;
+            return 1;
+        }
         res += (fst - snd) * (fst - snd);
         ++counter;
     }
-    if (fst_file.good() || snd_file.good()) {
+    if (snd_file >> snd) {
         std::cout << "Reached end only in one file" << std::endl;
         return 1;
     }
+    if (counter == 0) {
+        std::cout << "Files are empty" << std::endl;
+        return 1;
+    }
     std::cout << "Difference is " << (res / counter) << std::endl;
-    if (res / counter < 1e-6) {
+    if (res / counter < tolerance) {
         std::cout << "========== Test passed ==========" << std::endl;
     } else {
         std::cout << "========== Test failed ==========" << std::endl;
+        return 1;
     }
     return 0;
 }
@@ -1,7 +1,26 @@
-__kernel void preprocess_image(__global float* data) {
-    int myid = get_global_id(0);
-    data[myid] = data[myid] / 127.5;
-    data[myid] = data[myid] - 1;
+// Нормализация сырых пикселей (uint8, HWC) в [-1, 1], совмещённая с zero padding первого слоя.
+// Дополнительно можно вырезать центральную область исходного кадра и билинейно отмасштабировать её до width x height:
+// пиксель (x, y) выхода берётся из точки (crop_x + (x + 0.5) * scale_x - 0.5, crop_y + (y + 0.5) * scale_y - 0.5) исходника.
+// При scale = 1 и нулевом смещении это просто копирование пикселей.
+__kernel void preprocess_zeropadding2d(__global const uchar* input, __global float* output, int src_width, int src_height,
+                                       float crop_x, float crop_y, float scale_x, float scale_y, int width, int depth,
+                                       int pad_start_0, int pad_end_0, int pad_start_1, int pad_end_1) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    float src_x = clamp(crop_x + (x + 0.5f) * scale_x - 0.5f, 0.0f, (float)(src_width - 1));
+    float src_y = clamp(crop_y + (y + 0.5f) * scale_y - 0.5f, 0.0f, (float)(src_height - 1));
+    int x0 = (int)src_x;
+    int y0 = (int)src_y;
+    int x1 = min(x0 + 1, src_width - 1);
+    int y1 = min(y0 + 1, src_height - 1);
+    float fx = src_x - x0;
+    float fy = src_y - y0;
+    float top = input[(y0 * src_width + x0) * depth + z] * (1 - fx) + input[(y0 * src_width + x1) * depth + z] * fx;
+    float bottom = input[(y1 * src_width + x0) * depth + z] * (1 - fx) + input[(y1 * src_width + x1) * depth + z] * fx;
+    float value = top * (1 - fy) + bottom * fy;
+    int out_index = ((width + pad_start_0 + pad_end_0) * (pad_start_1 + y) + pad_start_0 + x) * depth + z;
+    output[out_index] = value / 127.5f - 1;
 }
 
 __kernel void zeropadding2d(__global const float* input, __global float* output, int width, int height, int depth,
@@ -14,29 +33,111 @@ __kernel void zeropadding2d(__global const float* input, __global float* output,
     output[out_index] = input[in_index];
 }
 
-__kernel void conv2d_kernel_9_valid(__global const float* input, __global float* output, __global const float* kernels, __global const float* bias,
-                                    int strides, int in_shape, const int width, int out_shape) {
-    int x = get_global_id(0);
-    int y = get_global_id(1);
+// Свёртка 3x3 (valid) алгоритмом Винограда F(2x2, 3x3). Преобразования раздельные: по строкам и по столбцам применяется
+// одно и то же одномерное преобразование из WINOGRAD_SIZE(strides) точек.
+// Страйд 1 -- обычный F(2, 3): вход d0..d3 переходит в (d0 - d2, d1 + d2, d2 - d1, d1 - d3), выход y0 = m0 + m1 + m2, y1 = m1 - m2 - m3.
+// Страйд 2 раскладывается по фазам: чётные отсчёты d0, d2, d4 сворачиваются с (g0, g2) через F(2, 2),
+// нечётные d1, d3 -- просто умножаются на g1. Нулевых отводов нет: 5 точек вместо 4 + 4 фаз по 16.
+// Веса преобразованы на хосте один раз (Conv2DLayer::transform_winograd_kernels).
+#define WINOGRAD_SIZE(strides) ((strides) == 1 ? 4 : 5)
+#define WINOGRAD_MAX_SIZE 5
+#define WINOGRAD_MAX_TILE (WINOGRAD_MAX_SIZE * WINOGRAD_MAX_SIZE)
+// Сколько входных каналов преобразуется за один проход work-группы (ограничено локальной памятью)
+#define WINOGRAD_CHANNELS 16
+
+void winograd_input_1d(float* t, const float* d, int step, int strides) {
+    if (strides == 1) {
+        t[0 * step] = d[0 * step] - d[2 * step];
+        t[1 * step] = d[1 * step] + d[2 * step];
+        t[2 * step] = d[2 * step] - d[1 * step];
+        t[3 * step] = d[1 * step] - d[3 * step];
+    } else {
+        t[0 * step] = d[0 * step] - d[2 * step];
+        t[1 * step] = d[2 * step];
+        t[2 * step] = d[4 * step] - d[2 * step];
+        t[3 * step] = d[1 * step];
+        t[4 * step] = d[3 * step];
+    }
+}
+
+void winograd_output_1d(float* y, const float* m, int step, int strides) {
+    if (strides == 1) {
+        y[0] = m[0 * step] + m[1 * step] + m[2 * step];
+        y[1] = m[1 * step] - m[2 * step] - m[3 * step];
+    } else {
+        y[0] = m[0 * step] + m[1 * step] + m[3 * step];
+        y[1] = m[1 * step] + m[2 * step] + m[4 * step];
+    }
+}
+
+// Work-группа -- один тайл 2x2 выхода, work-item в ней -- выходной канал. Преобразованный тайл входа V = T d T^T
+// считается один раз на входной канал, кладётся в локальную память и используется всеми выходными каналами группы.
+// Произведения копятся в пространстве Винограда, обратное преобразование делается один раз в конце.
+__kernel void conv2d_winograd_2x2_3x3(__global const float* input, __global float* output, __global const float* kernels, __global const float* bias,
+                                      int strides, int in_shape, int width, int height, int out_width, int out_height, int out_shape) {
+    __local float v[WINOGRAD_CHANNELS * WINOGRAD_MAX_TILE];
+    int tx = get_group_id(0);
+    int ty = get_group_id(1);
     int z = get_global_id(2);
-    int cor_x = x * strides + 1;
-    int cor_y = y * strides + 1;
-    int i;
-    for (i = 0; i < in_shape; ++i) {
-        int addr = z * 9 * in_shape + i * 9;
-        float conv = input[((cor_x - 1) * width + (cor_y - 1)) * in_shape + i] * kernels[addr+0]
-           + input[((cor_x) * width+(cor_y - 1)) * in_shape + i] * kernels[addr+1]
-           + input[((cor_x + 1) * width+(cor_y - 1)) * in_shape + i] * kernels[addr+2]
-           + input[((cor_x - 1) * width+(cor_y)) * in_shape + i] * kernels[addr+3]
-           + input[((cor_x) * width+(cor_y)) * in_shape + i] * kernels[addr+4]
-           + input[((cor_x + 1) * width+(cor_y)) * in_shape + i] * kernels[addr+5]
-           + input[((cor_x - 1) * width+(cor_y + 1)) * in_shape + i] * kernels[addr+6]
-           + input[((cor_x) * width+(cor_y + 1)) * in_shape + i] * kernels[addr+7]
-           + input[((cor_x + 1) * width+(cor_y + 1)) * in_shape + i] * kernels[addr+8];
-       output[((x * ((width-1)/strides) + y) * out_shape) + z] += conv;
+    int lz = get_local_id(2);
+    int group_size = get_local_size(2);
+    int n = WINOGRAD_SIZE(strides);
+    int tile = n * n;
+    float m[WINOGRAD_MAX_TILE];
+    for (int k = 0; k < tile; ++k) {
+        m[k] = 0;
     }
-    if (bias) {
-        output[((x * ((width-1)/strides) + y) * out_shape) + z] += bias[z];
+    for (int first = 0; first < in_shape; first += WINOGRAD_CHANNELS) {
+        int channels = min(WINOGRAD_CHANNELS, in_shape - first);
+        for (int c = lz; c < channels; c += group_size) {
+            float d[WINOGRAD_MAX_TILE];
+            for (int a = 0; a < n; ++a) {
+                int row = 2 * tx * strides + a;
+                for (int b = 0; b < n; ++b) {
+                    int col = 2 * ty * strides + b;
+                    d[a * n + b] = (row < height && col < width) ? input[(row * width + col) * in_shape + first + c] : 0;
+                }
+            }
+            float t[WINOGRAD_MAX_TILE];
+            for (int b = 0; b < n; ++b) {
+                winograd_input_1d(t + b, d + b, n, strides);
+            }
+            for (int a = 0; a < n; ++a) {
+                winograd_input_1d(d + a * n, t + a * n, 1, strides);
+            }
+            for (int k = 0; k < tile; ++k) {
+                v[c * tile + k] = d[k];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (int c = 0; c < channels; ++c) {
+            __global const float* u = kernels + (z * in_shape + first + c) * tile;
+            for (int k = 0; k < tile; ++k) {
+                m[k] += u[k] * v[c * tile + k];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    // y = A m A^T
+    float s[2 * WINOGRAD_MAX_SIZE];
+    for (int b = 0; b < n; ++b) {
+        float y[2];
+        winograd_output_1d(y, m + b, n, strides);
+        s[0 * n + b] = y[0];
+        s[1 * n + b] = y[1];
+    }
+    float b_z = bias ? bias[z] : 0;
+    for (int a = 0; a < 2; ++a) {
+        int x = 2 * tx + a;
+        if (x >= out_height) {
+            break;
+        }
+        float y[2];
+        winograd_output_1d(y, s + a * n, 1, strides);
+        output[((x * out_width + 2 * ty) * out_shape) + z] = y[0] + b_z;
+        if (2 * ty + 1 < out_width) {
+            output[((x * out_width + 2 * ty + 1) * out_shape) + z] = y[1] + b_z;
+        }
     }
 }
 
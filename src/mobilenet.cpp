@@ -0,0 +1,1131 @@
+#include "mobilenet.h"
+
+#include "ZFC_MobileNet_CPU.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cassert>
+#include <iomanip>
+#include <cmath>
+
+using namespace trained_layers;
+
+void check_error(cl_int error) {
+    if (error != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Error in OpenCL function") + std::to_string(error));
+    }
+}
+
+float get_seconds(struct timeval timeStart, struct timeval timeEnd) {
+    return ((timeEnd.tv_sec - timeStart.tv_sec) * 1000000 + timeEnd.tv_usec - timeStart.tv_usec) / 1.e6;
+}
+
+// --------------------
+
+struct ZeroPadding2DLayer : public Layer {
+    Data apply(InferenceSession& session, Data& input) const override;
+    Data apply_host(Data& input) const override;
+    LayerCost cost(const Data& input, const Data& output) const override;
+    std::string name() const override {
+        return "ZeroPadding2D";
+    }
+    // Нормализует сырое изображение и сразу дополняет его нулями, при необходимости с центральным кропом
+    // и билинейным масштабированием до width x height (0 -- оставить исходный размер)
+    Data apply_image(InferenceSession& session, const Image& image, int width, int height) const;
+
+    int pad_start_0 = 0;
+    int pad_end_0 = 1;
+    int pad_start_1 = 0;
+    int pad_end_1 = 1;
+};
+
+struct Conv2DLayer : public Layer {
+    Data apply(InferenceSession& session, Data& input) const override;
+    Data apply_host(Data& input) const override;
+    LayerCost cost(const Data& input, const Data& output) const override;
+    std::string name() const override {
+        return "Conv2D " + std::to_string(conv_size0) + "x" + std::to_string(conv_size1);
+    }
+
+    enum class Padding {
+        PADDING_VALID = 0,
+        PADDING_SAME
+    };
+
+    Conv2DLayer(int out_depth, int conv_size0, int conv_size1, int strides, float* bias, float* kernels, Padding padding) :
+                out_depth(out_depth),
+                conv_size0(conv_size0),
+                conv_size1(conv_size1),
+                strides(strides),
+                bias(bias),
+                kernels(kernels),
+                padding(padding) {}
+
+    int prepare(const cl::Context& context, int in_channels) override;
+    bool use_winograd() const;
+    void transform_winograd_kernels(int in_depth);
+    Data apply_winograd(InferenceSession& session, Data& input) const;
+
+    int out_depth;
+    int conv_size0;
+    int conv_size1;
+    int strides;
+    float* bias = nullptr;
+    float* kernels = nullptr;
+    Padding padding = Padding::PADDING_VALID;
+    // Веса, преобразованные для алгоритма Винограда F(2x2, 3x3): тайл 4x4 при страйде 1 и 5x5 при страйде 2
+    // на каждую пару (выходной канал, входной канал)
+    std::vector<float> winograd_kernels;
+    // Веса, загруженные на устройство в prepare
+    cl::Buffer kernels_buffer;
+    cl::Buffer bias_buffer;
+};
+
+struct Relu2DLayer : public Layer {
+    Data apply(InferenceSession& session, Data& input) const override;
+    Data apply_host(Data& input) const override;
+    std::string name() const override {
+        return "ReLU";
+    }
+};
+
+struct DepthwiseConv2DLayer : public Layer {
+    Data apply(InferenceSession& session, Data& input) const override;
+    Data apply_host(Data& input) const override;
+    LayerCost cost(const Data& input, const Data& output) const override;
+    std::string name() const override {
+        return "DepthwiseConv2D";
+    }
+
+    enum class Padding {
+        PADDING_VALID = 0,
+        PADDING_SAME
+    };
+
+    DepthwiseConv2DLayer(int conv_size0, int conv_size1, int strides, float* bias, float* kernels, Padding padding) :
+            conv_size0(conv_size0),
+            conv_size1(conv_size1),
+            strides(strides),
+            bias(bias),
+            kernels(kernels),
+            padding(padding) {}
+
+    int prepare(const cl::Context& context, int in_channels) override;
+
+    int conv_size0;
+    int conv_size1;
+    int strides;
+    float* bias = nullptr;
+    float* kernels = nullptr;
+    Padding padding = Padding::PADDING_VALID;
+    cl::Buffer kernels_buffer;
+    cl::Buffer bias_buffer;
+};
+
+struct GlobalAveragePooling2DLayer : public Layer {
+    Data apply(InferenceSession& session, Data& input) const override;
+    Data apply_host(Data& input) const override;
+    LayerCost cost(const Data& input, const Data& output) const override;
+    std::string name() const override {
+        return "GlobalAveragePooling2D";
+    }
+};
+
+struct Dense2DLayer : public Layer {
+    Data apply(InferenceSession& session, Data& input) const override;
+    Data apply_host(Data& input) const override;
+    LayerCost cost(const Data& input, const Data& output) const override;
+    std::string name() const override {
+        return "Dense";
+    }
+
+    Dense2DLayer(int out_shape, float* weights, float* bias) :
+            out_shape(out_shape),
+            weights(weights),
+            bias(bias) {}
+
+    int prepare(const cl::Context& context, int in_channels) override;
+
+    int out_shape;
+    float* weights = nullptr;
+    float* bias = nullptr;
+    cl::Buffer weights_buffer;
+};
+
+Data ZeroPadding2DLayer::apply(InferenceSession& session, Data& input) const {
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    std::vector<float> output((input.width + pad_start_0 + pad_end_0) *
+                              (input.height + pad_start_1 + pad_end_1) * input.channels, 0);
+    cl_int err;
+    cl::Event to_wait;
+    cl::Buffer buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * input.data.size(), input.data.data(), &err);
+    cl::Buffer buffer2(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+    check_error(err);
+    cl::Kernel& kernel = session.kernel("zeropadding2d");
+    err = kernel.setArg(0, buffer);
+    check_error(err);
+    err = kernel.setArg(1, buffer2);
+    check_error(err);
+    err = kernel.setArg(2, input.width);
+    check_error(err);
+    err = kernel.setArg(3, input.height);
+    check_error(err);
+    err = kernel.setArg(4, input.channels);
+    check_error(err);
+    err = kernel.setArg(5, pad_start_0);
+    check_error(err);
+    err = kernel.setArg(6, pad_end_0);
+    check_error(err);
+    err = kernel.setArg(7, pad_start_1);
+    check_error(err);
+    err = kernel.setArg(8, pad_end_1);
+    check_error(err);
+
+    err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(input.width, input.height, input.channels),
+            cl::NullRange, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer2, false, CL_MAP_READ, 0, sizeof(float) * output.size(), nullptr,
+                                            nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer2, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    Data res;
+    res.width = input.width + pad_start_0 + pad_end_0;
+    res.height = input.height + pad_start_1 + pad_end_1;
+    res.channels = input.channels;
+    res.data = std::move(output);
+    return res;
+}
+
+Data ZeroPadding2DLayer::apply_host(Data& input) const {
+    Data res;
+    res.width = input.width + pad_start_0 + pad_end_0;
+    res.height = input.height + pad_start_1 + pad_end_1;
+    res.channels = input.channels;
+    res.data.assign(res.width * res.height * res.channels, 0);
+    for (int y = 0; y < input.height; ++y) {
+        for (int x = 0; x < input.width; ++x) {
+            const float* in = input.data.data() + (y * input.width + x) * input.channels;
+            std::copy(in, in + input.channels, res.data.data() + (res.width * (pad_start_1 + y) + pad_start_0 + x) * input.channels);
+        }
+    }
+    return res;
+}
+
+LayerCost ZeroPadding2DLayer::cost(const Data& input, const Data& output) const {
+    LayerCost res;
+    res.bytes = sizeof(float) * (input.data.size() + output.data.size());
+    return res;
+}
+
+Data ZeroPadding2DLayer::apply_image(InferenceSession& session, const Image& image, int width, int height) const {
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    if (width <= 0 || height <= 0 || image.width <= 0 || image.height <= 0 || image.channels <= 0 ||
+        image.data.size() != size_t(image.width) * image.height * image.channels) {
+        throw std::runtime_error("Empty image or image of size " + std::to_string(image.width) + "x" +
+                                 std::to_string(image.height) + "x" + std::to_string(image.channels) + " with " +
+                                 std::to_string(image.data.size()) + " pixels can't be resized to " +
+                                 std::to_string(width) + "x" + std::to_string(height));
+    }
+    // Веса первой свёртки загружены под input_channels каналов, с другим числом каналов ядра читали бы за их пределами
+    if (image.channels != session.model().input_channels) {
+        throw std::runtime_error("Model expects images with " + std::to_string(session.model().input_channels) +
+                                 " channels, but here are " + std::to_string(image.channels));
+    }
+    // Центральный кроп с соотношением сторон целевого размера
+    float crop_width = image.width;
+    float crop_height = image.height;
+    if (crop_width * height > crop_height * width) {
+        crop_width = crop_height * width / height;
+    } else {
+        crop_height = crop_width * height / width;
+    }
+    float crop_x = (image.width - crop_width) / 2;
+    float crop_y = (image.height - crop_height) / 2;
+    float scale_x = crop_width / width;
+    float scale_y = crop_height / height;
+
+    Data res;
+    res.width = width + pad_start_0 + pad_end_0;
+    res.height = height + pad_start_1 + pad_end_1;
+    res.channels = image.channels;
+    std::vector<float> output(res.width * res.height * res.channels, 0);
+    cl_int err;
+    cl::Event to_wait;
+    cl::Buffer buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image.data.size(), const_cast<unsigned char*>(image.data.data()), &err);
+    cl::Buffer buffer2(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+    check_error(err);
+    cl::Kernel& kernel = session.kernel("preprocess_zeropadding2d");
+    err = kernel.setArg(0, buffer);
+    check_error(err);
+    err = kernel.setArg(1, buffer2);
+    check_error(err);
+    err = kernel.setArg(2, image.width);
+    check_error(err);
+    err = kernel.setArg(3, image.height);
+    check_error(err);
+    err = kernel.setArg(4, crop_x);
+    check_error(err);
+    err = kernel.setArg(5, crop_y);
+    check_error(err);
+    err = kernel.setArg(6, scale_x);
+    check_error(err);
+    err = kernel.setArg(7, scale_y);
+    check_error(err);
+    err = kernel.setArg(8, width);
+    check_error(err);
+    err = kernel.setArg(9, image.channels);
+    check_error(err);
+    err = kernel.setArg(10, pad_start_0);
+    check_error(err);
+    err = kernel.setArg(11, pad_end_0);
+    check_error(err);
+    err = kernel.setArg(12, pad_start_1);
+    check_error(err);
+    err = kernel.setArg(13, pad_end_1);
+    check_error(err);
+
+    err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height, image.channels),
+            cl::NullRange, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer2, false, CL_MAP_READ, 0, sizeof(float) * output.size(), nullptr,
+                                            nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer2, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    res.data = std::move(output);
+    return res;
+}
+
+int Conv2DLayer::prepare(const cl::Context& context, int in_channels) {
+    cl_int err;
+    if (use_winograd()) {
+        transform_winograd_kernels(in_channels);
+        kernels_buffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * winograd_kernels.size(),
+                                    winograd_kernels.data(), &err);
+    } else {
+        kernels_buffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * in_channels * conv_size0 * conv_size1 * out_depth,
+                                    kernels, &err);
+    }
+    check_error(err);
+    bias_buffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * out_depth, bias, &err);
+    check_error(err);
+    return out_depth;
+}
+
+bool Conv2DLayer::use_winograd() const {
+    return conv_size0 == 3 && conv_size1 == 3 && padding == Padding::PADDING_VALID && (strides == 1 || strides == 2);
+}
+
+void Conv2DLayer::transform_winograd_kernels(int in_depth) {
+    // U = H g H^T для каждой пары (выходной канал, входной канал), H -- преобразование ядра из conv2d_winograd_2x2_3x3.
+    // При страйде 1 это G из F(2, 3). При страйде 2 строки H -- ядро (g0, g2) для F(2, 2) по чётной фазе и g1 для нечётной.
+    const float G1[4][3] = {{1, 0, 0}, {0.5f, 0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}, {0, 0, 1}};
+    const float G2[5][3] = {{1, 0, 0}, {1, 0, 1}, {0, 0, 1}, {0, 1, 0}, {0, 1, 0}};
+    const float (*H)[3] = strides == 1 ? G1 : G2;
+    int n = strides == 1 ? 4 : 5;
+    winograd_kernels.assign(out_depth * in_depth * n * n, 0);
+    for (int z = 0; z < out_depth; ++z) {
+        for (int i = 0; i < in_depth; ++i) {
+            const float* g_full = kernels + z * 9 * in_depth + i * 9;
+            float g[3][3];
+            for (int a = 0; a < 3; ++a) {
+                for (int b = 0; b < 3; ++b) {
+                    g[a][b] = g_full[b * 3 + a];
+                }
+            }
+            std::vector<float> tmp(n * 3);
+            for (int a = 0; a < n; ++a) {
+                for (int b = 0; b < 3; ++b) {
+                    tmp[a * 3 + b] = H[a][0] * g[0][b] + H[a][1] * g[1][b] + H[a][2] * g[2][b];
+                }
+            }
+            float* u = winograd_kernels.data() + (z * in_depth + i) * n * n;
+            for (int a = 0; a < n; ++a) {
+                for (int b = 0; b < n; ++b) {
+                    u[a * n + b] = tmp[a * 3 + 0] * H[b][0] + tmp[a * 3 + 1] * H[b][1] + tmp[a * 3 + 2] * H[b][2];
+                }
+            }
+        }
+    }
+}
+
+Data Conv2DLayer::apply(InferenceSession& session, Data& input) const {
+    if (use_winograd()) {
+        return apply_winograd(session, input);
+    }
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    cl_int err;
+    cl::Kernel* kernel = nullptr;
+    Data res;
+    if (conv_size0 == 1 && conv_size1 == 1 && padding == Padding::PADDING_SAME) {
+        res.width = input.width;
+        res.height = input.height;
+        kernel = &session.kernel("conv2d_kernel_1_same");
+    } else {
+        throw std::runtime_error("This case is not implemented");
+    }
+    res.channels = out_depth;
+
+    std::vector<float> output(res.width * res.height * out_depth, 0);
+    cl::Event to_wait;
+    cl::Buffer buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * input.data.size(), input.data.data(), &err);
+    cl::Buffer buffer2(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+    check_error(err);
+    err = kernel->setArg(0, buffer);
+    check_error(err);
+    err = kernel->setArg(1, buffer2);
+    check_error(err);
+    err = kernel->setArg(2, kernels_buffer);
+    check_error(err);
+    err = kernel->setArg(3, bias_buffer); // TODO: bias can be separate kernel for all layers
+    check_error(err);
+    err = kernel->setArg(4, strides);
+    check_error(err);
+    err = kernel->setArg(5, input.channels);
+    check_error(err);
+    err = kernel->setArg(6, input.width);
+    check_error(err);
+    err = kernel->setArg(7, out_depth);
+    check_error(err);
+    err = queue.enqueueNDRangeKernel(*kernel, cl::NullRange, cl::NDRange(res.width, res.height, out_depth), cl::NullRange, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer2, false, CL_MAP_READ, 0, sizeof(float) * output.size(), nullptr,
+                                           nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer2, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    res.data = std::move(output);
+    return res;
+}
+
+Data Conv2DLayer::apply_winograd(InferenceSession& session, Data& input) const {
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    Data res;
+    res.width = (input.width - conv_size0) / strides + 1;
+    res.height = (input.height - conv_size1) / strides + 1;
+    res.channels = out_depth;
+
+    cl_int err;
+    std::vector<float> output(res.width * res.height * out_depth, 0);
+    cl::Event to_wait;
+    cl::Buffer buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * input.data.size(), input.data.data(), &err);
+    cl::Buffer buffer2(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+    check_error(err);
+    cl::Kernel& kernel = session.kernel("conv2d_winograd_2x2_3x3");
+    err = kernel.setArg(0, buffer);
+    check_error(err);
+    err = kernel.setArg(1, buffer2);
+    check_error(err);
+    err = kernel.setArg(2, kernels_buffer);
+    check_error(err);
+    err = kernel.setArg(3, bias_buffer);
+    check_error(err);
+    err = kernel.setArg(4, strides);
+    check_error(err);
+    err = kernel.setArg(5, input.channels);
+    check_error(err);
+    err = kernel.setArg(6, input.width);
+    check_error(err);
+    err = kernel.setArg(7, input.height);
+    check_error(err);
+    err = kernel.setArg(8, res.width);
+    check_error(err);
+    err = kernel.setArg(9, res.height);
+    check_error(err);
+    err = kernel.setArg(10, out_depth);
+    check_error(err);
+    // Одна work-группа на тайл 2x2 выхода. Чем больше выходных каналов в группе, тем реже повторяется преобразование входа,
+    // поэтому берётся наибольший делитель out_depth, который устройство может запустить одной группой.
+    size_t max_group_size = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(queue.getInfo<CL_QUEUE_DEVICE>(), &err);
+    check_error(err);
+    int group_size = out_depth;
+    while (group_size > 1 && (group_size > int(max_group_size) || out_depth % group_size != 0)) {
+        --group_size;
+    }
+    err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((res.height + 1) / 2, (res.width + 1) / 2, out_depth),
+                                     cl::NDRange(1, 1, group_size), nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer2, false, CL_MAP_READ, 0, sizeof(float) * output.size(), nullptr,
+                                           nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer2, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    res.data = std::move(output);
+    return res;
+}
+
+Data Conv2DLayer::apply_host(Data& input) const {
+    Data res;
+    if (use_winograd()) {
+        res.width = (input.width - conv_size0) / strides + 1;
+        res.height = (input.height - conv_size1) / strides + 1;
+    } else if (conv_size0 == 1 && conv_size1 == 1 && padding == Padding::PADDING_SAME) {
+        res.width = input.width;
+        res.height = input.height;
+    } else {
+        throw std::runtime_error("This case is not implemented");
+    }
+    res.channels = out_depth;
+    res.data.resize(res.width * res.height * out_depth);
+    int in_depth = input.channels;
+    for (int x = 0; x < res.height; ++x) {
+        for (int y = 0; y < res.width; ++y) {
+            float* out = res.data.data() + (x * res.width + y) * out_depth;
+            for (int z = 0; z < out_depth; ++z) {
+                float conv = bias ? bias[z] : 0;
+                if (conv_size0 == 1) {
+                    const float* in = input.data.data() + (x * input.width + y) * in_depth;
+                    const float* kernel = kernels + z * in_depth;
+                    for (int i = 0; i < in_depth; ++i) {
+                        conv += in[i] * kernel[i];
+                    }
+                } else {
+                    for (int a = 0; a < 3; ++a) {
+                        for (int b = 0; b < 3; ++b) {
+                            const float* in = input.data.data() + ((x * strides + a) * input.width + y * strides + b) * in_depth;
+                            for (int i = 0; i < in_depth; ++i) {
+                                conv += in[i] * kernels[z * 9 * in_depth + i * 9 + b * 3 + a];
+                            }
+                        }
+                    }
+                }
+                out[z] = conv;
+            }
+        }
+    }
+    return res;
+}
+
+LayerCost Conv2DLayer::cost(const Data& input, const Data& output) const {
+    LayerCost res;
+    res.flops = 2.0 * output.data.size() * input.channels * conv_size0 * conv_size1;
+    res.bytes = sizeof(float) * (input.data.size() + output.data.size() + out_depth * input.channels * conv_size0 * conv_size1);
+    return res;
+}
+
+Data Relu2DLayer::apply(InferenceSession& session, Data& input) const {
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    cl_int err;
+    cl::Event to_wait;
+    cl::Buffer buffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * input.data.size(), input.data.data(), &err);
+    check_error(err);
+    cl::Kernel& kernel = session.kernel("relu");
+    err = kernel.setArg(0, buffer);
+    check_error(err);
+    err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(input.data.size()), cl::NullRange, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer, false, CL_MAP_READ, 0, sizeof(float) * input.data.size(), nullptr,
+                                           nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    Data res;
+    res.width = input.width;
+    res.height = input.height;
+    res.channels = input.channels;
+    res.data = std::move(input.data);
+    return res;
+}
+
+Data Relu2DLayer::apply_host(Data& input) const {
+    for (auto& value : input.data) {
+        value = std::min(std::max(value, 0.0f), 1.0f);
+    }
+    return std::move(input);
+}
+
+int DepthwiseConv2DLayer::prepare(const cl::Context& context, int in_channels) {
+    cl_int err;
+    kernels_buffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * in_channels * conv_size0 * conv_size1, kernels, &err);
+    check_error(err);
+    bias_buffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * in_channels, bias, &err);
+    check_error(err);
+    return in_channels;
+}
+
+Data DepthwiseConv2DLayer::apply(InferenceSession& session, Data& input) const {
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    if (conv_size0 != 3 || conv_size1 != 3) {
+        throw std::runtime_error("This case is not implemented");
+    }
+    cl::Kernel* kernel = nullptr;
+    cl_int err;
+    Data res;
+    if (padding == Padding::PADDING_VALID) {
+        res.width = (input.width - 1) / strides;
+        res.height = (input.height - 1) / strides;
+        res.channels = input.channels;
+        kernel = &session.kernel("depthwise_conv2d_kernel_9_valid");
+    } else {
+        res.width = input.width;
+        res.height = input.height;
+        res.channels = input.channels;
+        kernel = &session.kernel("depthwise_conv2d_kernel_9_same");
+    }
+
+    std::vector<float> output(res.width * res.height * input.channels, 0);
+    cl::Event to_wait;
+    cl::Buffer buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * input.data.size(), input.data.data(), &err);
+    cl::Buffer buffer2(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+    check_error(err);
+    err = kernel->setArg(0, buffer);
+    check_error(err);
+    err = kernel->setArg(1, buffer2);
+    check_error(err);
+    err = kernel->setArg(2, kernels_buffer);
+    check_error(err);
+    err = kernel->setArg(3, bias_buffer);
+    check_error(err);
+    err = kernel->setArg(4, strides);
+    check_error(err);
+    err = kernel->setArg(5, input.channels);
+    check_error(err);
+    err = kernel->setArg(6, res.width);
+    check_error(err);
+    err = kernel->setArg(7, res.height);
+    check_error(err);
+    err = queue.enqueueNDRangeKernel(*kernel, cl::NullRange, cl::NDRange(res.width, res.height, input.channels), cl::NullRange, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer2, false, CL_MAP_READ, 0, sizeof(float) * output.size(), nullptr,
+                                           nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer2, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    res.data = std::move(output);
+    return res;
+}
+
+Data DepthwiseConv2DLayer::apply_host(Data& input) const {
+    if (conv_size0 != 3 || conv_size1 != 3) {
+        throw std::runtime_error("This case is not implemented");
+    }
+    Data res;
+    res.channels = input.channels;
+    if (padding == Padding::PADDING_VALID) {
+        res.width = (input.width - 1) / strides;
+        res.height = (input.height - 1) / strides;
+    } else {
+        // Как и ядро depthwise_conv2d_kernel_9_same, страйд здесь не учитывается
+        res.width = input.width;
+        res.height = input.height;
+    }
+    res.data.resize(res.width * res.height * res.channels);
+    int depth = input.channels;
+    for (int x = 0; x < res.width; ++x) {
+        for (int y = 0; y < res.height; ++y) {
+            for (int z = 0; z < depth; ++z) {
+                const float* kernel = kernels + z * 9;
+                float conv = 0;
+                for (int a = 0; a < 3; ++a) {
+                    for (int b = 0; b < 3; ++b) {
+                        int in_x;
+                        int in_y;
+                        if (padding == Padding::PADDING_VALID) {
+                            in_x = x * strides + a;
+                            in_y = y * strides + b;
+                        } else {
+                            in_x = x + a - 1;
+                            in_y = y + b - 1;
+                            if (in_x < 0 || in_y < 0 || in_x >= res.width || in_y >= res.height) {
+                                continue;
+                            }
+                        }
+                        conv += input.data[(in_x * input.width + in_y) * depth + z] * kernel[b * 3 + a];
+                    }
+                }
+                res.data[(x * res.width + y) * depth + z] = conv + (bias ? bias[z] : 0);
+            }
+        }
+    }
+    return res;
+}
+
+LayerCost DepthwiseConv2DLayer::cost(const Data& input, const Data& output) const {
+    LayerCost res;
+    res.flops = 2.0 * output.data.size() * conv_size0 * conv_size1;
+    res.bytes = sizeof(float) * (input.data.size() + output.data.size() + input.channels * conv_size0 * conv_size1);
+    return res;
+}
+
+Data GlobalAveragePooling2DLayer::apply(InferenceSession& session, Data& input) const {
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    Data res;
+    res.width = 1;
+    res.height = 1;
+    res.channels = input.channels;
+
+    std::vector<float> output(res.channels, 0);
+    cl::Event to_wait;
+    cl_int err;
+    cl::Buffer buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * input.data.size(), input.data.data(), &err);
+    cl::Buffer buffer2(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+    check_error(err);
+
+    {
+        cl::Kernel& kernel = session.kernel("sum_by_channels");
+        err = kernel.setArg(0, buffer);
+        check_error(err);
+        err = kernel.setArg(1, buffer2);
+        check_error(err);
+        err = kernel.setArg(2, res.channels);
+        check_error(err);
+        int size = input.data.size();
+        err = kernel.setArg(3, size);
+        check_error(err);
+        err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(output.size()), cl::NullRange, nullptr, &to_wait);
+        check_error(err);
+        to_wait.wait();
+    }
+
+    {
+        float reduction_coef = input.width * input.height;
+        cl::Kernel& kernel = session.kernel("apply_reduction");
+        err = kernel.setArg(0, buffer2);
+        check_error(err);
+        err = kernel.setArg(1, reduction_coef);
+        check_error(err);
+        err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(output.size()), cl::NullRange, nullptr, &to_wait);
+        check_error(err);
+        to_wait.wait();
+    }
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer2, false, CL_MAP_READ, 0, sizeof(float) * output.size(), nullptr,
+                                           nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer2, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+
+    res.data = std::move(output);
+    return res;
+}
+
+Data GlobalAveragePooling2DLayer::apply_host(Data& input) const {
+    Data res;
+    res.width = 1;
+    res.height = 1;
+    res.channels = input.channels;
+    res.data.assign(res.channels, 0);
+    for (size_t i = 0; i < input.data.size(); ++i) {
+        res.data[i % res.channels] += input.data[i];
+    }
+    float reduction_coef = input.width * input.height;
+    for (auto& value : res.data) {
+        value /= reduction_coef;
+    }
+    return res;
+}
+
+// Основная работа -- сложение всех элементов входа; деление на каналы выхода пренебрежимо мало
+LayerCost GlobalAveragePooling2DLayer::cost(const Data& input, const Data& output) const {
+    LayerCost res;
+    res.flops = input.data.size();
+    res.bytes = sizeof(float) * (input.data.size() + output.data.size());
+    return res;
+}
+
+int Dense2DLayer::prepare(const cl::Context& context, int in_channels) {
+    cl_int err;
+    weights_buffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * out_shape * in_channels, weights, &err);
+    check_error(err);
+    return out_shape;
+}
+
+Data Dense2DLayer::apply(InferenceSession& session, Data& input) const {
+    const cl::Context& context = session.context();
+    cl::CommandQueue& queue = session.queue();
+    Data res;
+    res.width = 1;
+    res.height = 1;
+    res.channels = out_shape;
+
+    std::vector<float> output(res.channels, 0);
+    float max_value = 0;
+    float sum = 0;
+    cl::Event to_wait;
+    cl_int err;
+    cl::Buffer buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * input.data.size(), input.data.data(), &err);
+    cl::Buffer buffer2(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+    cl::Buffer buffer4(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float), &max_value, &err);
+    cl::Buffer buffer5(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float), &sum, &err);
+    check_error(err);
+
+    {
+        cl::Kernel& kernel = session.kernel("dense_layer");
+        err = kernel.setArg(0, buffer);
+        check_error(err);
+        err = kernel.setArg(1, weights_buffer);
+        check_error(err);
+        err = kernel.setArg(2, buffer2);
+        check_error(err);
+        err = kernel.setArg(3, input.channels);
+        check_error(err);
+        err = kernel.setArg(4, res.channels);
+        check_error(err);
+        err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(output.size()), cl::NDRange(output.size()), nullptr, &to_wait);
+        check_error(err);
+        to_wait.wait();
+    }
+
+    void* map_ptr = queue.enqueueMapBuffer(buffer2, false, CL_MAP_READ, 0, sizeof(float) * output.size(), nullptr,
+                                           nullptr, &err);
+    check_error(err);
+    queue.enqueueUnmapMemObject(buffer2, map_ptr, nullptr, &to_wait);
+    check_error(err);
+    to_wait.wait();
+
+    res.data = std::move(output);
+    return res;
+}
+
+Data Dense2DLayer::apply_host(Data& input) const {
+    Data res;
+    res.width = 1;
+    res.height = 1;
+    res.channels = out_shape;
+    res.data.assign(out_shape, 0);
+    for (int y = 0; y < out_shape; ++y) {
+        for (int x = 0; x < input.channels; ++x) {
+            res.data[y] += input.data[x] * weights[y * input.channels + x];
+        }
+    }
+    // Софтмакс как в ядре dense_layer
+    float max_val = 0;
+    float sum = 0;
+    for (auto value : res.data) {
+        max_val = std::max(max_val, value);
+    }
+    for (auto& value : res.data) {
+        value = std::exp(value - max_val);
+        sum += value;
+    }
+    for (auto& value : res.data) {
+        value /= sum;
+    }
+    return res;
+}
+
+LayerCost Dense2DLayer::cost(const Data& input, const Data& output) const {
+    LayerCost res;
+    res.flops = 2.0 * input.data.size() * out_shape;
+    res.bytes = sizeof(float) * (input.data.size() + output.data.size() + input.data.size() * out_shape);
+    return res;
+}
+
+cl::Program build_program(const cl::Context& context, const std::string& kernels_path) {
+    cl_int err;
+    std::ifstream kernel_file(kernels_path);
+    std::string kernel_code(std::istreambuf_iterator<char>(kernel_file), (std::istreambuf_iterator<char>()));
+    cl::Program::Sources sources;
+    sources.push_back({kernel_code.c_str(), kernel_code.length()});
+    cl::Program program(context, sources, &err);
+    check_error(err);
+    err = program.build();
+    check_error(err);
+    return program;
+}
+
+std::shared_ptr<const MobileNet> init_mobilenet(const cl::Context& context, const cl::Program& program) {
+    std::shared_ptr<MobileNet> res(new MobileNet);
+    res->context = context;
+    res->program = program;
+    // Layer 1
+    res->layers.emplace_back(new ZeroPadding2DLayer);
+    // Layer 2
+    res->layers.emplace_back(new Conv2DLayer(8, 3, 3, 2, LAYER_LEVEL_2_BIAS, LAYER_LEVEL_2_WEIGHTS, Conv2DLayer::Padding::PADDING_VALID));
+    // Layer 3
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer 4
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 2, LAYER_LEVEL_4_BIAS, LAYER_LEVEL_4_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer 5
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer 6
+    res->layers.emplace_back(new Conv2DLayer(16, 1, 1, 1, LAYER_LEVEL_6_BIAS, LAYER_LEVEL_6_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer 7
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer8
+    res->layers.emplace_back(new ZeroPadding2DLayer);
+    // Layer9
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 2, LAYER_LEVEL_9_BIAS, LAYER_LEVEL_9_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_VALID));
+    // Layer10
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer11
+    res->layers.emplace_back(new Conv2DLayer(32, 1, 1, 1, LAYER_LEVEL_11_BIAS, LAYER_LEVEL_11_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer12
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer13
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_13_BIAS, LAYER_LEVEL_13_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer14
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer15
+    res->layers.emplace_back(new Conv2DLayer(32, 1, 1, 1, LAYER_LEVEL_15_BIAS, LAYER_LEVEL_15_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer16
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer17
+    res->layers.emplace_back(new ZeroPadding2DLayer);
+    // Layer18
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 2, LAYER_LEVEL_18_BIAS, LAYER_LEVEL_18_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_VALID));
+    // Layer19
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer20
+    res->layers.emplace_back(new Conv2DLayer(64, 1, 1, 1, LAYER_LEVEL_20_BIAS, LAYER_LEVEL_20_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer21
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer22
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_22_BIAS, LAYER_LEVEL_22_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer23
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer24
+    res->layers.emplace_back(new Conv2DLayer(64, 1, 1, 1, LAYER_LEVEL_24_BIAS, LAYER_LEVEL_24_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer25
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer26
+    res->layers.emplace_back(new ZeroPadding2DLayer);
+    // Layer27
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 2, LAYER_LEVEL_27_BIAS, LAYER_LEVEL_27_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_VALID));
+    // Layer28
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer29
+    res->layers.emplace_back(new Conv2DLayer(128, 1, 1, 1, LAYER_LEVEL_29_BIAS, LAYER_LEVEL_29_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer30
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer31
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_31_BIAS, LAYER_LEVEL_31_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer32
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer33
+    res->layers.emplace_back(new Conv2DLayer(128, 1, 1, 1, LAYER_LEVEL_33_BIAS, LAYER_LEVEL_33_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer34
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer35
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_35_BIAS, LAYER_LEVEL_35_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer36
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer37
+    res->layers.emplace_back(new Conv2DLayer(128, 1, 1, 1, LAYER_LEVEL_37_BIAS, LAYER_LEVEL_37_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer38
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer39
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_39_BIAS, LAYER_LEVEL_39_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer40
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer41
+    res->layers.emplace_back(new Conv2DLayer(128, 1, 1, 1, LAYER_LEVEL_41_BIAS, LAYER_LEVEL_41_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer42
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer43
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_43_BIAS, LAYER_LEVEL_43_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer44
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer45
+    res->layers.emplace_back(new Conv2DLayer(128, 1, 1, 1, LAYER_LEVEL_45_BIAS, LAYER_LEVEL_45_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer46
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer47
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_47_BIAS, LAYER_LEVEL_47_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer48
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer49
+    res->layers.emplace_back(new Conv2DLayer(128, 1, 1, 1, LAYER_LEVEL_49_BIAS, LAYER_LEVEL_49_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer50
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer51
+    res->layers.emplace_back(new ZeroPadding2DLayer);
+    // Layer52
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 2, LAYER_LEVEL_52_BIAS, LAYER_LEVEL_52_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_VALID));
+    // Layer53
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer54
+    res->layers.emplace_back(new Conv2DLayer(256, 1, 1, 1, LAYER_LEVEL_54_BIAS, LAYER_LEVEL_54_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer55
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer56
+    res->layers.emplace_back(new DepthwiseConv2DLayer(3, 3, 1, LAYER_LEVEL_56_BIAS, LAYER_LEVEL_56_WEIGHTS, DepthwiseConv2DLayer::Padding::PADDING_SAME));
+    // Layer57
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer58
+    res->layers.emplace_back(new Conv2DLayer(256, 1, 1, 1, LAYER_LEVEL_58_BIAS, LAYER_LEVEL_58_WEIGHTS, Conv2DLayer::Padding::PADDING_SAME));
+    // Layer59
+    res->layers.emplace_back(new Relu2DLayer);
+    // Layer60
+    res->layers.emplace_back(new GlobalAveragePooling2DLayer);
+    // Layer61
+    res->layers.emplace_back(new Dense2DLayer(2, LAYER_LEVEL_61_WEIGHTS, nullptr));
+
+    // Веса загружаются на устройство один раз, после этого модель не меняется
+    int channels = res->input_channels;
+    for (auto& layer : res->layers) {
+        channels = layer->prepare(context, channels);
+    }
+    return res;
+}
+
+// ------------------------------------
+
+std::vector<Image> read_images(const std::string& path) {
+    std::ifstream input(path);
+    int num_images;
+    if (!(input >> num_images) || num_images < 0) {
+        throw std::runtime_error("Can't read number of images from " + path);
+    }
+    std::vector<Image> images;
+    for (int i = 0; i < num_images; ++i) {
+        Image image;
+        input >> image.height;
+        input >> image.width;
+        input >> image.channels;
+        if (!input || image.height <= 0 || image.width <= 0) {
+            throw std::runtime_error("Bad size of image " + std::to_string(i) + " in " + path);
+        }
+        if (image.channels != 3) {
+            throw std::runtime_error("Only 3 channels are supported now, but here are " + std::to_string(image.channels));
+        }
+        for (int j = 0; j < image.height * image.width * image.channels; ++j) {
+            int elem;
+            if (!(input >> elem) || elem < 0 || elem > 255) {
+                throw std::runtime_error("Bad pixel value in image " + std::to_string(i) + " in " + path + ", expected 0..255");
+            }
+            image.data.push_back(elem);
+        }
+        images.push_back(image);
+    }
+    return images;
+}
+
+#ifdef DEBUG_LAYERS
+void dump_layer(const Data& features, int num_layer) {
+    std::ofstream output(std::string("debug_") + std::to_string(num_layer));
+    int idx = 0;
+    output << std::fixed << std::setprecision(6);
+    for (int i = 0; i < features.width; ++i) {
+        for (int j = 0; j < features.height; ++j) {
+            for (int k = 0; k < features.channels; ++k) {
+                output << features.data[idx++] << " ";
+            }
+        }
+        output << std::endl;
+    }
+}
+#endif
+
+InferenceSession::InferenceSession(std::shared_ptr<const MobileNet> mobile_net, int width, int height) :
+        mobile_net(std::move(mobile_net)),
+        width(width > 0 ? width : this->mobile_net->input_resolution),
+        height(height > 0 ? height : this->mobile_net->input_resolution) {
+    if (this->width != this->height || this->width % this->mobile_net->resolution_multiple != 0) {
+        throw std::runtime_error("Only square resolutions that are multiples of " + std::to_string(this->mobile_net->resolution_multiple) +
+                                 " are supported, but here is " + std::to_string(this->width) + "x" + std::to_string(this->height));
+    }
+    cl_int err;
+    command_queue = cl::CommandQueue(this->mobile_net->context, 0, &err);
+    check_error(err);
+}
+
+const cl::Context& InferenceSession::context() const {
+    return mobile_net->context;
+}
+
+cl::CommandQueue& InferenceSession::queue() {
+    return command_queue;
+}
+
+const MobileNet& InferenceSession::model() const {
+    return *mobile_net;
+}
+
+cl::Kernel& InferenceSession::kernel(const std::string& name) {
+    // Объект ядра хранит аргументы, поэтому у каждой сессии свои ядра
+    auto it = kernels.find(name);
+    if (it == kernels.end()) {
+        cl_int err;
+        cl::Kernel kernel(mobile_net->program, name.c_str(), &err);
+        check_error(err);
+        it = kernels.emplace(name, kernel).first;
+    }
+    return it->second;
+}
+
+std::vector<float> InferenceSession::infer(const Image& image) {
+    // Нормализация входа выполняется в том же ядре, что и первый zero padding.
+    // Если сеть начинается не с него, используется padding нулевой ширины.
+    auto first_layer = mobile_net->layers.begin();
+    ZeroPadding2DLayer no_padding;
+    no_padding.pad_end_0 = 0;
+    no_padding.pad_end_1 = 0;
+    auto padding = dynamic_cast<const ZeroPadding2DLayer*>(first_layer->get());
+    if (padding) {
+        ++first_layer;
+    } else {
+        padding = &no_padding;
+    }
+    Data features = padding->apply_image(*this, image, width, height);
+    int num_layer = 1;
+    if (padding != &no_padding) {
+#ifdef DEBUG_LAYERS
+        dump_layer(features, num_layer);
+#endif
+        if (layer_callback) {
+            layer_callback(num_layer, features);
+        }
+        ++num_layer;
+    }
+    for (auto it = first_layer; it != mobile_net->layers.end(); ++it) {
+        assert(features.data.size() == features.width * features.height * features.channels);
+        size_t index = it - mobile_net->layers.begin();
+        if (index < placement.size() && placement[index] == Placement::HOST) {
+            features = (*it)->apply_host(features);
+        } else {
+            features = (*it)->apply(*this, features);
+        }
+#ifdef DEBUG_LAYERS
+        dump_layer(features, num_layer);
+#endif
+        if (layer_callback) {
+            layer_callback(num_layer, features);
+        }
+        ++num_layer;
+    }
+    return features.data;
+}
+
+std::vector<std::vector<float>> InferenceSession::infer_batch(const std::vector<Image>& images) {
+    std::vector<std::vector<float>> res;
+    res.reserve(images.size());
+    for (const auto& image : images) {
+        res.push_back(infer(image));
+    }
+    return res;
+}
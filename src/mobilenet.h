@@ -0,0 +1,119 @@
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+struct Data {
+    int width = 1;
+    int height = 1;
+    int channels = 1;
+    std::vector<float> data;
+};
+
+// Исходное изображение: пиксели uint8 в порядке HWC, как они лежат во входном файле
+struct Image {
+    int width = 1;
+    int height = 1;
+    int channels = 3;
+    std::vector<unsigned char> data;
+};
+
+void check_error(cl_int error);
+
+float get_seconds(struct timeval timeStart, struct timeval timeEnd);
+
+// Читает файл изображений: количество изображений, затем для каждого строки, столбцы, каналы и сами пиксели
+std::vector<Image> read_images(const std::string& path);
+
+class InferenceSession;
+
+// Объём работы слоя для модели стоимости: арифметические операции и байты, которые нужно прочитать и записать
+struct LayerCost {
+    double flops = 0;
+    double bytes = 0;
+};
+
+// Где выполняется слой: ядром OpenCL на устройстве или обычным кодом на хосте
+enum class Placement {
+    DEVICE = 0,
+    HOST
+};
+
+// Слои не меняются во время инференса, поэтому одну модель можно одновременно использовать из нескольких сессий.
+// Всё изменяемое состояние (очередь, ядра, промежуточные буферы) принадлежит сессии.
+struct Layer {
+    virtual ~Layer() = default;
+
+    // Вызывается один раз при сборке модели: загружает веса на устройство. Возвращает число выходных каналов.
+    virtual int prepare(const cl::Context& context, int in_channels) {
+        return in_channels;
+    }
+    virtual Data apply(InferenceSession& session, Data& input) const = 0;
+    // Тот же слой на хосте; результат совпадает с ядром OpenCL с точностью до округления
+    virtual Data apply_host(Data& input) const = 0;
+    // По умолчанию слой поэлементный: одна операция на элемент выхода
+    virtual LayerCost cost(const Data& input, const Data& output) const {
+        LayerCost res;
+        res.flops = output.data.size();
+        res.bytes = sizeof(float) * (input.data.size() + output.data.size());
+        return res;
+    }
+    virtual std::string name() const = 0;
+};
+
+struct MobileNet {
+    cl::Context context;
+    cl::Program program;
+    std::vector<std::unique_ptr<Layer>> layers;
+    // Разрешение, на котором обучена сеть (квадрат input_resolution x input_resolution)
+    int input_resolution = 128;
+    // Число каналов входного изображения (RGB), под него загружены веса первой свёртки
+    int input_channels = 3;
+    // Сторона входа должна делиться на это число: перед каждым из пяти слоёв со страйдом 2 размер должен быть чётным,
+    // иначе ядра depthwise_conv2d_kernel_9_valid и последующие читают строки неправильной длины
+    int resolution_multiple = 32;
+};
+
+cl::Program build_program(const cl::Context& context, const std::string& kernels_path);
+
+std::shared_ptr<const MobileNet> init_mobilenet(const cl::Context& context, const cl::Program& program);
+
+// Сессия инференса. Сессии независимы друг от друга: у каждой своя очередь команд и свои объекты ядер,
+// поэтому из разных потоков можно работать с разными сессиями над одной моделью без блокировок.
+// Одну сессию одновременно из нескольких потоков использовать нельзя.
+// Сессия сама делает предобработку: на вход подаются сырые кадры (Image) любого размера, они обрезаются по центру,
+// масштабируются до width x height и нормализуются на устройстве. По умолчанию (0) это разрешение модели.
+// Число каналов кадра должно совпадать с MobileNet::input_channels.
+// Ядра после первого слоя поддерживают только квадратные входы со стороной, кратной MobileNet::resolution_multiple,
+// поэтому другие размеры отклоняются исключением.
+class InferenceSession {
+public:
+    explicit InferenceSession(std::shared_ptr<const MobileNet> mobile_net, int width = 0, int height = 0);
+
+    std::vector<float> infer(const Image& image);
+    std::vector<std::vector<float>> infer_batch(const std::vector<Image>& images);
+
+    const cl::Context& context() const;
+    cl::CommandQueue& queue();
+    cl::Kernel& kernel(const std::string& name);
+    const MobileNet& model() const;
+
+    // Если задан, вызывается после каждого слоя с его номером (с 1) и выходом, например для сверки с эталонными активациями
+    std::function<void(int, const Data&)> layer_callback;
+    // Размещение слоёв mobile_net->layers (см. place_layers в placement.h); если слоёв больше, остальные выполняются на устройстве.
+    // Первый zero padding совмещён с нормализацией входа и всегда выполняется на устройстве.
+    std::vector<Placement> placement;
+
+private:
+    std::shared_ptr<const MobileNet> mobile_net;
+    int width;
+    int height;
+    cl::CommandQueue command_queue;
+    std::map<std::string, cl::Kernel> kernels;
+};
@@ -0,0 +1,229 @@
+#include "placement.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+
+namespace {
+    struct LaunchTime {
+        double kernel = std::numeric_limits<double>::max();
+        double map = std::numeric_limits<double>::max();
+    };
+
+    // Запуск ядра так же, как это делают слои: буфер поверх памяти хоста, ожидание ядра, затем map/unmap результата.
+    // Возвращает лучшее из repeat время ядра и время map/unmap.
+    LaunchTime time_launch(InferenceSession& session, cl::Kernel& kernel, cl::Buffer& output, size_t output_size,
+                           const cl::NDRange& range, int repeat) {
+        LaunchTime res;
+        for (int i = 0; i < repeat; ++i) {
+            cl_int err;
+            cl::Event to_wait;
+            struct timeval timeStart, timeKernel, timeEnd;
+            gettimeofday(&timeStart, NULL);
+            err = session.queue().enqueueNDRangeKernel(kernel, cl::NullRange, range, cl::NullRange, nullptr, &to_wait);
+            check_error(err);
+            to_wait.wait();
+            gettimeofday(&timeKernel, NULL);
+            void* map_ptr = session.queue().enqueueMapBuffer(output, false, CL_MAP_READ, 0, sizeof(float) * output_size, nullptr,
+                                                             nullptr, &err);
+            check_error(err);
+            session.queue().enqueueUnmapMemObject(output, map_ptr, nullptr, &to_wait);
+            to_wait.wait();
+            gettimeofday(&timeEnd, NULL);
+            res.kernel = std::min(res.kernel, double(get_seconds(timeStart, timeKernel)));
+            res.map = std::min(res.map, double(get_seconds(timeKernel, timeEnd)));
+        }
+        return res;
+    }
+
+    LaunchTime time_relu(InferenceSession& session, std::vector<float>& data, int repeat) {
+        cl_int err;
+        cl::Buffer buffer(session.context(), CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * data.size(), data.data(), &err);
+        check_error(err);
+        cl::Kernel& kernel = session.kernel("relu");
+        err = kernel.setArg(0, buffer);
+        check_error(err);
+        return time_launch(session, kernel, buffer, data.size(), cl::NDRange(data.size()), repeat);
+    }
+
+    // Поточечная свёртка -- самая тяжёлая часть сети, по ней калибруется производительность устройства и хоста
+    const int calibration_size = 64;
+    const int calibration_depth = 128;
+
+    double calibration_flops() {
+        return 2.0 * calibration_size * calibration_size * calibration_depth * calibration_depth;
+    }
+
+    double time_device_conv(InferenceSession& session, std::vector<float>& input, std::vector<float>& weights, std::vector<float>& bias) {
+        cl_int err;
+        std::vector<float> output(input.size(), 0);
+        cl::Buffer buffer(session.context(), CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * input.size(), input.data(), &err);
+        cl::Buffer buffer2(session.context(), CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float) * output.size(), output.data(), &err);
+        cl::Buffer buffer3(session.context(), CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * weights.size(), weights.data(), &err);
+        cl::Buffer buffer4(session.context(), CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * bias.size(), bias.data(), &err);
+        check_error(err);
+        cl::Kernel& kernel = session.kernel("conv2d_kernel_1_same");
+        err = kernel.setArg(0, buffer);
+        check_error(err);
+        err = kernel.setArg(1, buffer2);
+        check_error(err);
+        err = kernel.setArg(2, buffer3);
+        check_error(err);
+        err = kernel.setArg(3, buffer4);
+        check_error(err);
+        err = kernel.setArg(4, 1);
+        check_error(err);
+        err = kernel.setArg(5, calibration_depth);
+        check_error(err);
+        err = kernel.setArg(6, calibration_size);
+        check_error(err);
+        err = kernel.setArg(7, calibration_depth);
+        check_error(err);
+        return time_launch(session, kernel, buffer2, output.size(),
+                           cl::NDRange(calibration_size, calibration_size, calibration_depth), 3).kernel;
+    }
+
+    double time_host_conv(const std::vector<float>& input, const std::vector<float>& weights, const std::vector<float>& bias) {
+        std::vector<float> output(input.size());
+        struct timeval timeStart, timeEnd;
+        gettimeofday(&timeStart, NULL);
+        for (int p = 0; p < calibration_size * calibration_size; ++p) {
+            for (int z = 0; z < calibration_depth; ++z) {
+                float conv = bias[z];
+                for (int i = 0; i < calibration_depth; ++i) {
+                    conv += input[p * calibration_depth + i] * weights[z * calibration_depth + i];
+                }
+                output[p * calibration_depth + z] = conv;
+            }
+        }
+        gettimeofday(&timeEnd, NULL);
+        // Результат используется, чтобы компилятор не выкинул цикл
+        volatile float sink = output.back();
+        (void)sink;
+        return get_seconds(timeStart, timeEnd);
+    }
+
+    double time_host_clamp(std::vector<float>& data) {
+        struct timeval timeStart, timeEnd;
+        gettimeofday(&timeStart, NULL);
+        for (auto& value : data) {
+            value = std::min(std::max(value, 0.0f), 1.0f);
+        }
+        gettimeofday(&timeEnd, NULL);
+        volatile float sink = data.back();
+        (void)sink;
+        return get_seconds(timeStart, timeEnd);
+    }
+
+    // Защита от деления на ноль, если операция быстрее разрешения таймера
+    double positive(double seconds) {
+        return std::max(seconds, 1e-6);
+    }
+
+    std::string shape(const Data& data) {
+        return std::to_string(data.width) + "x" + std::to_string(data.height) + "x" + std::to_string(data.channels);
+    }
+}
+
+double CostModel::predict(const LayerCost& cost, const Data& input, const Data& output, Placement placement) const {
+    if (placement == Placement::HOST) {
+        return std::max(cost.flops / host_flops, cost.bytes / host_bandwidth);
+    }
+    double transfer = sizeof(float) * (input.data.size() + output.data.size());
+    return device_latency + std::max(cost.flops / device_flops, cost.bytes / device_bandwidth) + transfer / transfer_bandwidth;
+}
+
+CostModel calibrate_cost_model(InferenceSession& session) {
+    CostModel res;
+
+    std::vector<float> small(1, 0.5f);
+    LaunchTime latency = time_relu(session, small, 10);
+    res.device_latency = latency.kernel + latency.map;
+
+    std::vector<float> large(1 << 22, 0.5f);
+    double large_bytes = sizeof(float) * large.size();
+    LaunchTime streaming = time_relu(session, large, 3);
+    res.device_bandwidth = 2 * large_bytes / positive(streaming.kernel - latency.kernel);
+    res.transfer_bandwidth = large_bytes / positive(streaming.map - latency.map);
+    res.host_bandwidth = 2 * large_bytes / positive(time_host_clamp(large));
+
+    std::vector<float> input(calibration_size * calibration_size * calibration_depth, 0.5f);
+    std::vector<float> weights(calibration_depth * calibration_depth, 0.01f);
+    std::vector<float> bias(calibration_depth, 0);
+    res.device_flops = calibration_flops() / positive(time_device_conv(session, input, weights, bias) - latency.kernel);
+    res.host_flops = calibration_flops() / positive(time_host_conv(input, weights, bias));
+    return res;
+}
+
+std::vector<Placement> place_layers(InferenceSession& session, const Image& sample, const CostModel& cost_model, std::ostream& report) {
+    const auto& layers = session.model().layers;
+
+    // Формы входа и выхода каждого слоя берутся из прогона на устройстве
+    std::vector<Data> outputs;
+    session.placement.clear();
+    session.layer_callback = [&outputs](int, const Data& features) {
+        outputs.push_back(features);
+    };
+    session.infer(sample);
+    session.layer_callback = nullptr;
+    if (outputs.size() != layers.size()) {
+        throw std::runtime_error("Number of layer outputs differs from number of layers");
+    }
+
+    // Слои независимы: между ними данные всегда лежат на хосте, поэтому для каждого слоя достаточно выбрать более дешёвый вариант.
+    // Первый слой получает на вход исходное изображение (и совмещён с его нормализацией), он всегда выполняется на устройстве.
+    std::vector<Placement> placement(layers.size(), Placement::DEVICE);
+    std::vector<double> device_time(layers.size());
+    std::vector<double> host_time(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const Data& input = i == 0 ? outputs[0] : outputs[i - 1];
+        LayerCost cost = layers[i]->cost(input, outputs[i]);
+        device_time[i] = cost_model.predict(cost, input, outputs[i], Placement::DEVICE);
+        host_time[i] = cost_model.predict(cost, input, outputs[i], Placement::HOST);
+        if (i > 0 && host_time[i] < device_time[i]) {
+            placement[i] = Placement::HOST;
+        }
+    }
+
+    // Измерение выбранного разбиения: время слоя -- промежуток между соседними вызовами layer_callback
+    session.placement = placement;
+    session.infer(sample);
+    std::vector<double> measured;
+    struct timeval last;
+    session.layer_callback = [&measured, &last](int, const Data&) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        measured.push_back(get_seconds(last, now));
+        last = now;
+    };
+    gettimeofday(&last, NULL);
+    session.infer(sample);
+    session.layer_callback = nullptr;
+
+    // Формат report меняется только на время печати отчёта
+    std::ios_base::fmtflags flags = report.flags();
+    std::streamsize precision = report.precision();
+    report << std::fixed << std::setprecision(3);
+    report << "Cost model: device " << cost_model.device_flops / 1e9 << " GFLOP/s, " << cost_model.device_bandwidth / 1e9 << " GB/s, "
+           << "launch " << cost_model.device_latency * 1e3 << " ms, transfer " << cost_model.transfer_bandwidth / 1e9 << " GB/s; "
+           << "host " << cost_model.host_flops / 1e9 << " GFLOP/s, " << cost_model.host_bandwidth / 1e9 << " GB/s" << std::endl;
+    report << std::setw(6) << "layer" << std::setw(24) << "name" << std::setw(14) << "output"
+           << std::setw(12) << "device ms" << std::setw(12) << "host ms" << std::setw(8) << "place"
+           << std::setw(14) << "predicted ms" << std::setw(13) << "measured ms" << std::endl;
+    double total_predicted = 0;
+    double total_measured = 0;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        double predicted = placement[i] == Placement::HOST ? host_time[i] : device_time[i];
+        total_predicted += predicted;
+        total_measured += measured[i];
+        report << std::setw(6) << i + 1 << std::setw(24) << layers[i]->name() << std::setw(14) << shape(outputs[i])
+               << std::setw(12) << device_time[i] * 1e3 << std::setw(12) << host_time[i] * 1e3
+               << std::setw(8) << (placement[i] == Placement::HOST ? "host" : "device")
+               << std::setw(14) << predicted * 1e3 << std::setw(13) << measured[i] * 1e3 << std::endl;
+    }
+    report << "Total: predicted " << total_predicted * 1e3 << " ms, measured " << total_measured * 1e3 << " ms, "
+           << std::count(placement.begin(), placement.end(), Placement::HOST) << " of " << layers.size() << " layers on host" << std::endl;
+    report.flags(flags);
+    report.precision(precision);
+    return placement;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "mobilenet.h"
+
+#include <ostream>
+
+// Модель стоимости для выбора, где выполнять слой. Все параметры измеряются на конкретной машине в calibrate_cost_model.
+// Слои обмениваются данными через память хоста, поэтому слой на устройстве платит за запуск ядра и передачу
+// своего входа и выхода, а слой на хосте -- только за вычисления.
+struct CostModel {
+    double device_flops = 0;       // операций в секунду на устройстве
+    double device_bandwidth = 0;   // байт в секунду между ядром и памятью устройства
+    double device_latency = 0;     // секунд на запуск ядра с ожиданием и map/unmap результата
+    double transfer_bandwidth = 0; // байт в секунду между хостом и устройством
+    double host_flops = 0;
+    double host_bandwidth = 0;
+
+    double predict(const LayerCost& cost, const Data& input, const Data& output, Placement placement) const;
+};
+
+CostModel calibrate_cost_model(InferenceSession& session);
+
+// Выбирает для каждого слоя устройство или хост по модели стоимости, записывает выбор в session.placement
+// и печатает в report разбиение с предсказанным и измеренным на sample временем каждого слоя
+std::vector<Placement> place_layers(InferenceSession& session, const Image& sample, const CostModel& cost_model, std::ostream& report);
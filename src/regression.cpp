@@ -0,0 +1,338 @@
+#include "mobilenet.h"
+#include "placement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+// Регрессионная проверка точности и производительности.
+//
+// capture сохраняет эталонные выходы всех слоёв для каждого изображения и пропускную способность сети в бинарный файл.
+// check прогоняет те же изображения, сравнивает выход каждого слоя с эталоном (max abs, относительная ошибка, ULP)
+// и падает, если превышен допуск или пропускная способность упала сильнее, чем на perf-tol.
+// С --threads N check одновременно прогоняет изображения в N сессиях над одной моделью, каждая в своём потоке,
+// и сверяет с эталоном выходы каждой сессии.
+//
+// Формат эталонного файла (все числа little-endian):
+//   char[4] "MNGT", int32 версия, int32 число изображений, double изображений в секунду,
+//   далее для каждого изображения: int32 число слоёв, для каждого слоя int32 width, height, channels и float[width * height * channels].
+
+namespace {
+    const char golden_magic[4] = {'M', 'N', 'G', 'T'};
+    const int32_t golden_version = 1;
+
+    struct Options {
+        double abs_tol = 1e-4;
+        double rel_tol = 1e-3;
+        int64_t ulp_tol = 0;
+        double perf_tol = 0.1;
+        int repeat = 3;
+        int threads = 1;
+        bool place = false;
+    };
+
+    struct Golden {
+        double images_per_second = 0;
+        std::vector<std::vector<Data>> layers;
+    };
+
+    struct LayerError {
+        double max_abs = 0;
+        double max_rel = 0;
+        int64_t max_ulp = 0;
+        int64_t violations = 0;
+    };
+}
+
+template <class T>
+void write_value(std::ostream& output, const T& value) {
+    output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+T read_value(std::istream& input) {
+    T value;
+    input.read(reinterpret_cast<char*>(&value), sizeof(value));
+    if (!input) {
+        throw std::runtime_error("Golden file is truncated");
+    }
+    return value;
+}
+
+void write_golden(const std::string& path, const Golden& golden) {
+    std::ofstream output(path, std::ios::binary);
+    output.write(golden_magic, sizeof(golden_magic));
+    write_value(output, golden_version);
+    write_value(output, static_cast<int32_t>(golden.layers.size()));
+    write_value(output, golden.images_per_second);
+    for (const auto& layers : golden.layers) {
+        write_value(output, static_cast<int32_t>(layers.size()));
+        for (const auto& layer : layers) {
+            write_value(output, static_cast<int32_t>(layer.width));
+            write_value(output, static_cast<int32_t>(layer.height));
+            write_value(output, static_cast<int32_t>(layer.channels));
+            output.write(reinterpret_cast<const char*>(layer.data.data()), sizeof(float) * layer.data.size());
+        }
+    }
+    if (!output) {
+        throw std::runtime_error("Can't write golden file " + path);
+    }
+}
+
+Golden read_golden(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Can't open golden file " + path + ", run capture first");
+    }
+    char magic[4];
+    input.read(magic, sizeof(magic));
+    if (!input || std::memcmp(magic, golden_magic, sizeof(magic)) != 0 || read_value<int32_t>(input) != golden_version) {
+        throw std::runtime_error("Unsupported golden file " + path);
+    }
+    Golden golden;
+    golden.layers.resize(read_value<int32_t>(input));
+    golden.images_per_second = read_value<double>(input);
+    for (auto& layers : golden.layers) {
+        layers.resize(read_value<int32_t>(input));
+        for (auto& layer : layers) {
+            layer.width = read_value<int32_t>(input);
+            layer.height = read_value<int32_t>(input);
+            layer.channels = read_value<int32_t>(input);
+            layer.data.resize(layer.width * layer.height * layer.channels);
+            input.read(reinterpret_cast<char*>(layer.data.data()), sizeof(float) * layer.data.size());
+            if (!input) {
+                throw std::runtime_error("Golden file is truncated");
+            }
+        }
+    }
+    return golden;
+}
+
+// Расстояние между числами в ULP: float переводится в целое так, чтобы порядок целых совпадал с порядком float
+int64_t ulp_distance(float a, float b) {
+    int32_t ia;
+    int32_t ib;
+    std::memcpy(&ia, &a, sizeof(a));
+    std::memcpy(&ib, &b, sizeof(b));
+    int64_t oa = ia < 0 ? int64_t(std::numeric_limits<int32_t>::min()) - ia : ia;
+    int64_t ob = ib < 0 ? int64_t(std::numeric_limits<int32_t>::min()) - ib : ib;
+    return std::abs(oa - ob);
+}
+
+// Элемент нарушает допуск, если |a - b| > abs_tol + rel_tol * |b| (как numpy.allclose) или, при заданном ulp_tol, расходится больше чем на ulp_tol ULP
+void compare_layer(const Data& actual, const Data& golden, const Options& options, LayerError& error) {
+    if (actual.width != golden.width || actual.height != golden.height || actual.channels != golden.channels) {
+        throw std::runtime_error("Layer shape differs from golden: " +
+                                 std::to_string(actual.width) + "x" + std::to_string(actual.height) + "x" + std::to_string(actual.channels) + " vs " +
+                                 std::to_string(golden.width) + "x" + std::to_string(golden.height) + "x" + std::to_string(golden.channels));
+    }
+    for (size_t i = 0; i < golden.data.size(); ++i) {
+        double diff = std::fabs(double(actual.data[i]) - golden.data[i]);
+        double magnitude = std::fabs(golden.data[i]);
+        int64_t ulp = ulp_distance(actual.data[i], golden.data[i]);
+        error.max_abs = std::max(error.max_abs, diff);
+        if (magnitude > options.abs_tol) {
+            error.max_rel = std::max(error.max_rel, diff / magnitude);
+        }
+        error.max_ulp = std::max(error.max_ulp, ulp);
+        if (!(diff <= options.abs_tol + options.rel_tol * magnitude) || (options.ulp_tol > 0 && ulp > options.ulp_tol)) {
+            ++error.violations;
+        }
+    }
+}
+
+std::vector<std::vector<Data>> run_layers(InferenceSession& session, const std::vector<Image>& images) {
+    std::vector<std::vector<Data>> res;
+    session.layer_callback = [&res](int, const Data& features) {
+        res.back().push_back(features);
+    };
+    for (const auto& image : images) {
+        res.emplace_back();
+        session.infer(image);
+    }
+    session.layer_callback = nullptr;
+    return res;
+}
+
+// Лучшая из options.repeat попыток после одного прогрева
+double measure_throughput(InferenceSession& session, const std::vector<Image>& images, const Options& options) {
+    session.infer_batch(images);
+    double best = 0;
+    for (int i = 0; i < options.repeat; ++i) {
+        struct timeval timeStart, timeEnd;
+        gettimeofday(&timeStart, NULL);
+        session.infer_batch(images);
+        session.queue().finish();
+        gettimeofday(&timeEnd, NULL);
+        best = std::max(best, images.size() / double(get_seconds(timeStart, timeEnd)));
+    }
+    return best;
+}
+
+int capture(InferenceSession& session, const std::vector<Image>& images, const std::string& golden_path, const Options& options) {
+    Golden golden;
+    golden.layers = run_layers(session, images);
+    golden.images_per_second = measure_throughput(session, images, options);
+    write_golden(golden_path, golden);
+    std::cout << "Captured " << golden.layers.size() << " images with " << golden.layers.front().size() << " layers each" << std::endl;
+    printf("Throughput baseline: %.3lf images/sec\n", golden.images_per_second);
+    return 0;
+}
+
+// Прогоняет изображения одновременно в options.threads сессиях: первая -- session, остальные создаются над той же моделью
+// с тем же размещением слоёв. Исключение из потока пробрасывается после завершения всех потоков.
+std::vector<std::vector<std::vector<Data>>> run_sessions(const std::shared_ptr<const MobileNet>& mobile_net, InferenceSession& session,
+                                                         const std::vector<Image>& images, const Options& options) {
+    std::vector<std::unique_ptr<InferenceSession>> extra_sessions;
+    std::vector<InferenceSession*> sessions = {&session};
+    for (int t = 1; t < options.threads; ++t) {
+        extra_sessions.emplace_back(new InferenceSession(mobile_net));
+        extra_sessions.back()->placement = session.placement;
+        sessions.push_back(extra_sessions.back().get());
+    }
+
+    std::vector<std::vector<std::vector<Data>>> res(sessions.size());
+    std::vector<std::exception_ptr> errors(sessions.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < sessions.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            try {
+                res[t] = run_layers(*sessions[t], images);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return res;
+}
+
+int check(const std::shared_ptr<const MobileNet>& mobile_net, InferenceSession& session, const std::vector<Image>& images,
+          const std::string& golden_path, const Options& options) {
+    Golden golden = read_golden(golden_path);
+    if (golden.layers.size() != images.size()) {
+        throw std::runtime_error("Golden file has " + std::to_string(golden.layers.size()) + " images, but " +
+                                 std::to_string(images.size()) + " were given");
+    }
+    auto actual = run_sessions(mobile_net, session, images, options);
+
+    // Ошибки слоя -- худшие по всем сессиям; при нескольких потоках дополнительно печатается число нарушений в каждой сессии
+    bool passed = true;
+    std::vector<LayerError> errors(golden.layers.front().size());
+    for (size_t t = 0; t < actual.size(); ++t) {
+        int64_t session_violations = 0;
+        for (size_t i = 0; i < images.size(); ++i) {
+            if (actual[t][i].size() != errors.size() || golden.layers[i].size() != errors.size()) {
+                throw std::runtime_error("Number of layers differs from golden");
+            }
+            for (size_t j = 0; j < errors.size(); ++j) {
+                int64_t violations = errors[j].violations;
+                compare_layer(actual[t][i][j], golden.layers[i][j], options, errors[j]);
+                session_violations += errors[j].violations - violations;
+            }
+        }
+        if (actual.size() > 1) {
+            std::cout << "Session " << t + 1 << " of " << actual.size() << ": " << session_violations << " violations"
+                      << (session_violations ? "  FAILED" : "") << std::endl;
+        }
+    }
+    std::cout << std::setw(6) << "layer" << std::setw(14) << "max_abs" << std::setw(14) << "max_rel"
+              << std::setw(12) << "max_ulp" << std::setw(12) << "violations" << std::endl;
+    for (size_t j = 0; j < errors.size(); ++j) {
+        const auto& error = errors[j];
+        std::cout << std::setw(6) << j + 1 << std::scientific << std::setprecision(3)
+                  << std::setw(14) << error.max_abs << std::setw(14) << error.max_rel
+                  << std::setw(12) << error.max_ulp << std::setw(12) << error.violations
+                  << (error.violations ? "  FAILED" : "") << std::endl;
+        passed = passed && error.violations == 0;
+    }
+
+    double images_per_second = measure_throughput(session, images, options);
+    double min_images_per_second = golden.images_per_second * (1 - options.perf_tol);
+    printf("Throughput: %.3lf images/sec, baseline %.3lf, allowed minimum %.3lf\n",
+           images_per_second, golden.images_per_second, min_images_per_second);
+    if (images_per_second < min_images_per_second) {
+        std::cout << "Throughput regression" << std::endl;
+        passed = false;
+    }
+
+    if (passed) {
+        std::cout << "========== Test passed ==========" << std::endl;
+        return 0;
+    }
+    std::cout << "========== Test failed ==========" << std::endl;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4 || (std::string(argv[1]) != "capture" && std::string(argv[1]) != "check")) {
+        std::cout << "Usage: " << argv[0] << " capture|check images_file golden_file"
+                  << " [--abs-tol x] [--rel-tol x] [--ulp-tol n] [--perf-tol x] [--repeat n] [--place 0|1] [--threads n]" << std::endl;
+        return 1;
+    }
+    Options options;
+    for (int i = 4; i < argc; i += 2) {
+        std::string name = argv[i];
+        if (i + 1 == argc) {
+            throw std::runtime_error("No value for option " + name);
+        }
+        if (name == "--abs-tol") {
+            options.abs_tol = std::stod(argv[i + 1]);
+        } else if (name == "--rel-tol") {
+            options.rel_tol = std::stod(argv[i + 1]);
+        } else if (name == "--ulp-tol") {
+            options.ulp_tol = std::stoll(argv[i + 1]);
+        } else if (name == "--perf-tol") {
+            options.perf_tol = std::stod(argv[i + 1]);
+        } else if (name == "--repeat") {
+            options.repeat = std::stoi(argv[i + 1]);
+        } else if (name == "--threads") {
+            options.threads = std::stoi(argv[i + 1]);
+            if (options.threads < 1) {
+                throw std::runtime_error("Number of threads must be positive");
+            }
+        } else if (name == "--place") {
+            options.place = std::stoi(argv[i + 1]) != 0;
+        } else {
+            throw std::runtime_error("Unknown option " + name);
+        }
+    }
+
+    std::vector<cl::Platform> platforms;
+    auto err = cl::Platform::get(&platforms);
+    check_error(err);
+    std::vector<cl::Device> devices;
+    err = platforms.front().getDevices(CL_DEVICE_TYPE_ALL, &devices);
+    check_error(err);
+    cl::Context context({devices.front()});
+
+    auto mobile_net = init_mobilenet(context, build_program(context, "kernels.cl"));
+    InferenceSession session(mobile_net);
+    std::vector<Image> images = read_images(argv[2]);
+    if (images.empty()) {
+        throw std::runtime_error(std::string("No images in ") + argv[2]);
+    }
+
+    if (options.place) {
+        place_layers(session, images.front(), calibrate_cost_model(session), std::cout);
+    }
+
+    if (std::string(argv[1]) == "capture") {
+        return capture(session, images, argv[3], options);
+    }
+    return check(mobile_net, session, images, argv[3], options);
+}